@@ -0,0 +1,269 @@
+#ifndef CATALOG_HPP_
+#define CATALOG_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Store.hpp"
+
+namespace server
+{
+    // 商店目录的一个不可变版本. 各版本之间共享没有改动过的 Store,
+    // 写入只会复制指针数组和被修改的那一个 Store.
+    struct CatalogVersion
+    {
+        std::uint64_t version = 0;
+        std::vector<std::shared_ptr<const Store>> stores;
+
+        const Store *find(const std::string &name) const
+        {
+            for (auto &store : stores)
+                if (store->name == name)
+                    return store.get();
+            return nullptr;
+        }
+    };
+
+    // 基于 epoch 的内存回收
+    //
+    // 读者进入时把全局 epoch 写进自己线程的槽位, 离开时清空; 写者替换版本后
+    // 把旧版本连同当时的 epoch 放进待回收列表, 等所有活跃读者的 epoch 都比它新
+    // 再释放. 读路径只有普通的 load/store 和一次 fence, 没有锁, 也没有
+    // fetch_add / compare_exchange 之类的读-改-写操作.
+    class EpochDomain
+    {
+    public:
+        static constexpr std::uint64_t idle = UINT64_MAX;
+        static constexpr size_t maxThreads = 256;
+
+        static EpochDomain &instance()
+        {
+            static EpochDomain domain;
+            return domain;
+        }
+
+        void enter()
+        {
+            Registration &registration = local();
+            if (registration.depth++ == 0)
+            {
+                Slot &slot = slots[registration.index];
+                slot.epoch.store(globalEpoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+                // 保证槽位的写入先于之后对版本指针的读取被写者看到
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+
+        void leave()
+        {
+            Registration &registration = local();
+            if (--registration.depth == 0)
+                slots[registration.index].epoch.store(idle, std::memory_order_release);
+        }
+
+        // 写者调用: 推进 epoch, 返回推进前的值, 用来标记刚刚被替换下来的版本
+        std::uint64_t advance()
+        {
+            return globalEpoch.fetch_add(1, std::memory_order_seq_cst);
+        }
+
+        // 所有活跃读者里最老的 epoch, 没有活跃读者时返回 idle
+        std::uint64_t oldestActive() const
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::uint64_t oldest = idle;
+            for (auto &slot : slots)
+                oldest = std::min(oldest, slot.epoch.load(std::memory_order_acquire));
+            return oldest;
+        }
+
+    private:
+        struct alignas(64) Slot
+        {
+            std::atomic<std::uint64_t> epoch{idle};
+            std::atomic<bool> used{false};
+        };
+
+        // 每个线程第一次读时占用一个槽位, 线程退出时归还
+        struct Registration
+        {
+            size_t index;
+            int depth = 0;
+
+            explicit Registration(EpochDomain &domain) : index(domain.claim()) {}
+            ~Registration() { EpochDomain::instance().slots[index].used.store(false, std::memory_order_release); }
+        };
+
+        size_t claim()
+        {
+            for (size_t i = 0; i < maxThreads; ++i)
+            {
+                bool expected = false;
+                if (!slots[i].used.load(std::memory_order_relaxed) &&
+                    slots[i].used.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+                    return i;
+            }
+            throw std::runtime_error("Too many catalog reader threads");
+        }
+
+        Registration &local()
+        {
+            thread_local Registration registration(*this);
+            return registration;
+        }
+
+        std::array<Slot, maxThreads> slots;
+        alignas(64) std::atomic<std::uint64_t> globalEpoch{0};
+    };
+
+    // 版本化的商店目录
+    //
+    //     auto snapshot = catalog.read();
+    //     for (auto &store : snapshot->stores) ...
+    //
+    // snapshot 存活期间看到的版本不会变化, 也不会被释放.
+    class Catalog
+    {
+    public:
+        class Snapshot
+        {
+        public:
+            Snapshot() : version(nullptr) {}
+            explicit Snapshot(const std::atomic<const CatalogVersion *> &current)
+            {
+                EpochDomain::instance().enter();
+                version = current.load(std::memory_order_acquire);
+            }
+            Snapshot(Snapshot &&other) noexcept : version(other.version) { other.version = nullptr; }
+            Snapshot(const Snapshot &) = delete;
+            Snapshot &operator=(const Snapshot &) = delete;
+            ~Snapshot()
+            {
+                if (version)
+                    EpochDomain::instance().leave();
+            }
+
+            const CatalogVersion *get() const { return version; }
+            const CatalogVersion *operator->() const { return version; }
+            const CatalogVersion &operator*() const { return *version; }
+
+        private:
+            const CatalogVersion *version;
+        };
+
+        Catalog() : current(new CatalogVersion()) {}
+
+        ~Catalog()
+        {
+            // 析构时不应再有读者
+            delete current.load();
+            for (auto &retired : retiredVersions)
+                delete retired.second;
+        }
+
+        Catalog(const Catalog &) = delete;
+        Catalog &operator=(const Catalog &) = delete;
+
+        Snapshot read() const { return Snapshot(current); }
+
+        // 在当前版本的副本上执行 mutate, 然后发布成新版本, 返回新版本号
+        template <class F>
+        std::uint64_t update(F &&mutate)
+        {
+            return publish(std::forward<F>(mutate), std::nullopt);
+        }
+
+        std::uint64_t addStore(Store store)
+        {
+            auto shared = std::make_shared<const Store>(std::move(store));
+            return update([&shared](std::vector<std::shared_ptr<const Store>> &stores)
+                          { stores.push_back(std::move(shared)); });
+        }
+
+        std::uint64_t replaceStore(size_t index, Store store)
+        {
+            auto shared = std::make_shared<const Store>(std::move(store));
+            return update([&](std::vector<std::shared_ptr<const Store>> &stores)
+                          {
+                if (index >= stores.size())
+                {
+                    throw std::runtime_error("Store not found");
+                }
+                stores[index] = std::move(shared); });
+        }
+
+        // 整体替换并把版本号设为 version, 用于从快照恢复
+        std::uint64_t reset(std::vector<Store> stores, std::uint64_t version)
+        {
+            std::vector<std::shared_ptr<const Store>> shared;
+            shared.reserve(stores.size());
+            for (auto &store : stores)
+                shared.push_back(std::make_shared<const Store>(std::move(store)));
+            return publish([&shared](std::vector<std::shared_ptr<const Store>> &current)
+                           { current = std::move(shared); },
+                           version);
+        }
+
+        std::vector<Store> copyStores() const
+        {
+            Snapshot snapshot = read();
+            std::vector<Store> result;
+            result.reserve(snapshot->stores.size());
+            for (auto &store : snapshot->stores)
+                result.push_back(*store);
+            return result;
+        }
+
+        size_t retiredAmount()
+        {
+            std::lock_guard<std::mutex> lock(writeLock);
+            return retiredVersions.size();
+        }
+
+    private:
+        // 不指定 version 时新版本号是旧版本号加一
+        template <class F>
+        std::uint64_t publish(F &&mutate, std::optional<std::uint64_t> version)
+        {
+            std::lock_guard<std::mutex> lock(writeLock);
+            const CatalogVersion *old = current.load(std::memory_order_relaxed);
+            std::unique_ptr<CatalogVersion> next(new CatalogVersion(*old));
+            mutate(next->stores);
+            next->version = version ? *version : old->version + 1;
+            std::uint64_t published = next->version;
+            current.store(next.release(), std::memory_order_seq_cst);
+            retiredVersions.emplace_back(EpochDomain::instance().advance(), old);
+            reclaim();
+            return published;
+        }
+
+        // 调用前必须持有 writeLock
+        void reclaim()
+        {
+            std::uint64_t oldest = EpochDomain::instance().oldestActive();
+            auto end = std::remove_if(retiredVersions.begin(), retiredVersions.end(),
+                                      [oldest](const std::pair<std::uint64_t, const CatalogVersion *> &retired)
+                                      {
+                                          if (retired.first >= oldest)
+                                              return false;
+                                          delete retired.second;
+                                          return true;
+                                      });
+            retiredVersions.erase(end, retiredVersions.end());
+        }
+
+        std::atomic<const CatalogVersion *> current;
+        std::mutex writeLock;
+        std::vector<std::pair<std::uint64_t, const CatalogVersion *>> retiredVersions;
+    };
+}
+
+#endif
@@ -0,0 +1,107 @@
+// 目录读扩展性测试: 快照读 vs 互斥锁读, 同时有一个写线程持续发布新版本
+// g++ -std=gnu++17 -O2 CatalogBench.cpp -o CatalogBench -pthread
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Catalog.hpp"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static server::Store makeStore(int i)
+{
+    server::Store store;
+    store.name = "store" + to_string(i);
+    store.customerAmount = i;
+    store.dishes.push_back(server::Dish{"dish", 10, "bowl", 0});
+    return store;
+}
+
+// 每个读线程不停地读, 写线程每毫秒改一次, 返回所有读线程的总读次数/秒
+template <class Read, class Write>
+static double run(unsigned int threadAmount, Read &&read, Write &&write)
+{
+    atomic<bool> stop{false};
+    vector<unsigned long long> counts(threadAmount * 8, 0);
+    vector<thread> readers;
+    for (unsigned int t = 0; t < threadAmount; ++t)
+        readers.emplace_back([&, t]()
+                             {
+            unsigned long long count = 0;
+            long long sink = 0;
+            while (!stop.load(memory_order_relaxed))
+            {
+                sink += read(static_cast<int>(count % 64));
+                ++count;
+            }
+            counts[t * 8] = count + (sink == -1); });
+    thread writer([&]()
+                  {
+        int i = 0;
+        while (!stop.load(memory_order_relaxed))
+        {
+            write(i++ % 64);
+            this_thread::sleep_for(chrono::milliseconds(1));
+        } });
+
+    auto start = Clock::now();
+    this_thread::sleep_for(chrono::milliseconds(500));
+    stop.store(true);
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+    for (auto &t : readers)
+        t.join();
+    writer.join();
+    unsigned long long total = 0;
+    for (unsigned int t = 0; t < threadAmount; ++t)
+        total += counts[t * 8];
+    return total / seconds;
+}
+
+int main()
+{
+    server::Catalog catalog;
+    vector<server::Store> locked;
+    mutex lock;
+    for (int i = 0; i < 64; ++i)
+    {
+        catalog.addStore(makeStore(i));
+        locked.push_back(makeStore(i));
+    }
+
+    unsigned int maxThreads = thread::hardware_concurrency() ? thread::hardware_concurrency() : 4;
+    for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        double snapshotReads = run(
+            threads,
+            [&](int i)
+            {
+                auto snapshot = catalog.read();
+                return snapshot->stores[i]->customerAmount;
+            },
+            [&](int i)
+            { catalog.replaceStore(i, makeStore(i)); });
+
+        double mutexReads = run(
+            threads,
+            [&](int i)
+            {
+                lock_guard<mutex> guard(lock);
+                return locked[i].customerAmount;
+            },
+            [&](int i)
+            {
+                server::Store store = makeStore(i);
+                lock_guard<mutex> guard(lock);
+                locked[i] = move(store);
+            });
+
+        cout << threads << " threads: snapshot " << snapshotReads / 1e6 << " M reads/s, mutex "
+             << mutexReads / 1e6 << " M reads/s" << endl;
+    }
+    cout << "retired versions pending: " << catalog.retiredAmount() << endl;
+    return 0;
+}
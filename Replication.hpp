@@ -0,0 +1,660 @@
+#ifndef REPLICATION_HPP_
+#define REPLICATION_HPP_
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Catalog.hpp"
+#include "Serializer.hpp"
+// Windows only
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32")
+#endif
+
+// 主节点内存里保留的最近修改记录条数, 落后更多的从节点需要先拿快照
+#ifndef REPLICATION_LOG_SIZE
+#define REPLICATION_LOG_SIZE 4096
+#endif
+
+// 单个复制帧的长度上限, 超过的帧直接断开, 防止对端用长度字段让本进程分配大块内存
+#ifndef REPLICATION_MAX_FRAME
+#define REPLICATION_MAX_FRAME (64u << 20)
+#endif
+
+// 主从复制
+//
+// 主节点上每次修改商店目录都会生成一条带序号的记录 (序号就是修改后的目录版本号),
+// 通过 TCP 推送给从节点. 从节点按序号顺序应用, 只提供只读路由.
+// 主节点每次启动生成一个随机的 incarnation, 序号只在同一个 incarnation 内有意义.
+// 从节点连上来时报告自己的 incarnation 和已经应用到的序号: incarnation 一致并且
+// 主节点还保留着后续记录就直接补发, 否则先发一份快照, 再接着发快照之后的记录.
+//
+// 帧格式: 1 字节类型 + 4 字节小端长度 + 载荷 (载荷使用 Serializer.hpp 的二进制编码)
+//   'H' 从 -> 主  incarnation + 已应用的序号
+//   'S' 主 -> 从  快照: incarnation + 版本号 + 整个目录
+//   'R' 主 -> 从  一条修改记录
+//   'B' 主 -> 从  主节点最新序号 + 时间: 每批 'S'/'R' 之前发一次, 空闲时每秒发一次
+namespace replication
+{
+    enum class MutationType
+    {
+        AddStore,
+        ReplaceStore
+    };
+
+    struct Mutation
+    {
+        std::uint64_t sequence = 0;
+        std::int64_t timestamp = 0; // 主节点产生记录的时间 (毫秒)
+        int type = static_cast<int>(MutationType::AddStore);
+        std::uint64_t index = 0;
+        server::Store store;
+    };
+
+    struct Hello
+    {
+        std::uint64_t incarnation = 0; // 从节点还没有拿过快照时为 0
+        std::uint64_t applied = 0;
+    };
+
+    struct Heartbeat
+    {
+        std::uint64_t sequence = 0;
+        std::int64_t timestamp = 0;
+    };
+
+    // 复制状态, 通过 /ReplicationStatus 以 JSON 返回
+    struct Status
+    {
+        std::string role;
+        std::uint64_t incarnation = 0;
+        bool connected = false;
+        std::uint64_t applied = 0;
+        std::uint64_t primarySequence = 0;
+        std::uint64_t lagRecords = 0;
+        std::int64_t lagMs = 0;
+        int followers = 0;
+    };
+
+    constexpr auto describe(const Mutation *)
+    {
+        return std::make_tuple(serializer::field("sequence", &Mutation::sequence),
+                               serializer::field("timestamp", &Mutation::timestamp),
+                               serializer::field("type", &Mutation::type),
+                               serializer::field("index", &Mutation::index),
+                               serializer::field("store", &Mutation::store));
+    }
+
+    constexpr auto describe(const Hello *)
+    {
+        return std::make_tuple(serializer::field("incarnation", &Hello::incarnation),
+                               serializer::field("applied", &Hello::applied));
+    }
+
+    constexpr auto describe(const Heartbeat *)
+    {
+        return std::make_tuple(serializer::field("sequence", &Heartbeat::sequence),
+                               serializer::field("timestamp", &Heartbeat::timestamp));
+    }
+
+    constexpr auto describe(const Status *)
+    {
+        return std::make_tuple(serializer::field("role", &Status::role),
+                               serializer::field("incarnation", &Status::incarnation),
+                               serializer::field("connected", &Status::connected),
+                               serializer::field("applied", &Status::applied),
+                               serializer::field("primarySequence", &Status::primarySequence),
+                               serializer::field("lagRecords", &Status::lagRecords),
+                               serializer::field("lagMs", &Status::lagMs),
+                               serializer::field("followers", &Status::followers));
+    }
+
+    inline std::int64_t nowMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    inline void sendFrame(SOCKET socket, char type, const std::string &payload)
+    {
+        char header[5] = {type,
+                          static_cast<char>(payload.size() & 0xff),
+                          static_cast<char>((payload.size() >> 8) & 0xff),
+                          static_cast<char>((payload.size() >> 16) & 0xff),
+                          static_cast<char>((payload.size() >> 24) & 0xff)};
+        // 每个线程复用同一个缓冲区, 头和载荷仍然一次 send 出去
+        thread_local std::string frame;
+        frame.assign(header, sizeof(header));
+        frame.append(payload);
+        size_t sent = 0;
+        while (sent < frame.size())
+        {
+            int data = send(socket, frame.data() + sent, static_cast<int>(frame.size() - sent), 0);
+            if (data <= 0)
+                throw std::runtime_error("Replication connection lost " + std::to_string(GetLastError()));
+            sent += data;
+        }
+    }
+
+    inline void recvExact(SOCKET socket, char *buffer, size_t length)
+    {
+        size_t received = 0;
+        while (received < length)
+        {
+            int data = recv(socket, buffer + received, static_cast<int>(length - received), 0);
+            if (data <= 0)
+                throw std::runtime_error("Replication connection lost " + std::to_string(GetLastError()));
+            received += data;
+        }
+    }
+
+    inline char recvFrame(SOCKET socket, std::string &payload)
+    {
+        unsigned char header[5];
+        recvExact(socket, reinterpret_cast<char *>(header), sizeof(header));
+        size_t length = header[1] | (header[2] << 8) | (header[3] << 16) | (static_cast<size_t>(header[4]) << 24);
+        if (length > REPLICATION_MAX_FRAME)
+        {
+            throw std::runtime_error("Replication frame too large");
+        }
+        payload.resize(length);
+        if (length)
+            recvExact(socket, &payload[0], length);
+        return static_cast<char>(header[0]);
+    }
+
+    // 主节点: 所有对目录的修改都经过这里, 保证目录版本和记录序号一一对应
+    class Primary
+    {
+    public:
+        explicit Primary(server::Catalog &catalog) : catalog(catalog), incarnation(newIncarnation()) {}
+
+        // 先用 path 里已有的记录重建目录, 之后的每条修改记录都以一行 JSON 追加到 path
+        // (writeLogRecord 格式, 带序号). 必须在 listen 之前调用, 否则重启后的主节点
+        // 会把空目录当快照发给从节点.
+        void openLog(const std::string &path)
+        {
+            std::lock_guard<std::mutex> lock(logLock);
+            replay(path);
+            logFile.open(path, std::ios::app | std::ios::binary);
+            if (!logFile)
+            {
+                throw std::runtime_error("Failed to open " + path);
+            }
+        }
+
+        std::uint64_t addStore(server::Store store)
+        {
+            std::lock_guard<std::mutex> lock(logLock);
+            Mutation mutation = nextMutation(MutationType::AddStore);
+            mutation.store = store;
+            persist(mutation);
+            catalog.addStore(std::move(store));
+            return append(mutation);
+        }
+
+        std::uint64_t replaceStore(size_t index, server::Store store)
+        {
+            std::lock_guard<std::mutex> lock(logLock);
+            if (index >= catalog.read()->stores.size())
+            {
+                throw std::runtime_error("Store not found");
+            }
+            Mutation mutation = nextMutation(MutationType::ReplaceStore);
+            mutation.index = index;
+            mutation.store = store;
+            persist(mutation);
+            catalog.replaceStore(index, std::move(store));
+            return append(mutation);
+        }
+
+        // 在 port 上等待从节点连接, 每个从节点一个发送线程
+        void listen(int port)
+        {
+            SOCKET listener = socket(AF_INET, SOCK_STREAM, 0);
+            if (listener == -1)
+            {
+                throw std::runtime_error("Failed to create replication socket " + std::to_string(GetLastError()));
+            }
+            struct sockaddr_in address;
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port);
+            address.sin_addr.S_un.S_addr = inet_addr("0.0.0.0");
+            if (bind(listener, (struct sockaddr *)&address, sizeof(address)) == -1 || ::listen(listener, 10) == -1)
+            {
+                throw std::runtime_error("Failed to listen on replication port " + std::to_string(GetLastError()));
+            }
+            std::cout << "Replication is listening on port " << port << std::endl;
+            std::thread([this, listener]()
+                        {
+                while (true)
+                {
+                    SOCKET follower = accept(listener, nullptr, nullptr);
+                    if (follower == -1)
+                    {
+                        std::cout << "Failed to accept follower " << GetLastError() << std::endl;
+                        continue;
+                    }
+                    std::thread(&Primary::serve, this, follower).detach();
+                } })
+                .detach();
+        }
+
+        Status status()
+        {
+            Status result;
+            result.role = "primary";
+            result.incarnation = incarnation;
+            result.connected = true;
+            result.applied = catalog.read()->version;
+            result.primarySequence = result.applied;
+            result.followers = followers.load();
+            return result;
+        }
+
+    private:
+        static std::uint64_t newIncarnation()
+        {
+            std::random_device device;
+            std::uint64_t id = (static_cast<std::uint64_t>(device()) << 32) ^ device() ^
+                               static_cast<std::uint64_t>(nowMs());
+            return id ? id : 1;
+        }
+
+        struct Entry
+        {
+            std::uint64_t sequence;
+            std::string payload;
+        };
+
+        // 调用前必须持有 logLock. 记录必须从当前版本号开始连续;
+        // 崩溃时只写了一半的最后一行会被截掉, 其他解析不了的行则拒绝启动.
+        // 在副本上重放完再整体发布一次, 不为每条记录复制一遍目录
+        void replay(const std::string &path)
+        {
+            std::ifstream input(path, std::ios::binary);
+            if (!input)
+                return;
+            std::vector<server::Store> stores = catalog.copyStores();
+            std::uint64_t version = catalog.read()->version;
+            std::string line;
+            std::uintmax_t complete = 0;
+            size_t lineNumber = 0;
+            std::uint64_t replayed = 0;
+            while (std::getline(input, line))
+            {
+                ++lineNumber;
+                if (input.eof())
+                {
+                    // 没有换行符说明这条记录没写完, 它的修改也从未发布过
+                    std::cout << "Dropping truncated record at " << path << " line " << lineNumber << std::endl;
+                    input.close();
+                    std::filesystem::resize_file(path, complete);
+                    break;
+                }
+                Mutation mutation;
+                try
+                {
+                    serializer::readJson(line, mutation);
+                }
+                catch (const std::exception &e)
+                {
+                    throw std::runtime_error(path + " line " + std::to_string(lineNumber) + ": " + e.what());
+                }
+                if (mutation.sequence != version + 1)
+                {
+                    throw std::runtime_error(path + " line " + std::to_string(lineNumber) + ": expected sequence " +
+                                             std::to_string(version + 1));
+                }
+                if (mutation.type == static_cast<int>(MutationType::AddStore))
+                    stores.push_back(std::move(mutation.store));
+                else if (mutation.index < stores.size())
+                    stores[mutation.index] = std::move(mutation.store);
+                else
+                {
+                    throw std::runtime_error(path + " line " + std::to_string(lineNumber) + ": store not found");
+                }
+                version = mutation.sequence;
+                complete += line.size() + 1;
+                ++replayed;
+            }
+            if (!replayed)
+                return;
+            catalog.reset(std::move(stores), version);
+            std::cout << "Replayed " << replayed << " records from " << path << std::endl;
+        }
+
+        // 调用前必须持有 logLock. 目录只在 logLock 下修改, 所以下一个版本号是确定的
+        Mutation nextMutation(MutationType type)
+        {
+            Mutation mutation;
+            mutation.type = static_cast<int>(type);
+            mutation.sequence = catalog.read()->version + 1;
+            mutation.timestamp = nowMs();
+            return mutation;
+        }
+
+        // 调用前必须持有 logLock. 先落盘再发布, 写失败时这次修改不生效
+        void persist(const Mutation &mutation)
+        {
+            if (!logFile.is_open())
+                return;
+            record.clear();
+            serializer::writeLogRecord(record, mutation);
+            logFile.write(record.data(), record.size());
+            logFile.flush();
+            if (!logFile)
+            {
+                logFile.clear();
+                throw std::runtime_error("Failed to write store log");
+            }
+        }
+
+        // 调用前必须持有 logLock
+        std::uint64_t append(const Mutation &mutation)
+        {
+            Entry entry{mutation.sequence, std::string()};
+            serializer::writeBinary(entry.payload, mutation);
+            log.push_back(std::move(entry));
+            if (log.size() > REPLICATION_LOG_SIZE)
+                log.pop_front();
+            logCV.notify_all();
+            return mutation.sequence;
+        }
+
+        void serve(SOCKET follower)
+        {
+            ++followers;
+            try
+            {
+                std::string payload;
+                if (recvFrame(follower, payload) != 'H')
+                {
+                    throw std::runtime_error("Expected replication hello");
+                }
+                Hello hello;
+                serializer::readBinary(payload, hello);
+                std::cout << "Follower connected at sequence " << hello.applied << std::endl;
+
+                std::uint64_t next = hello.applied + 1;
+                // 从节点的历史属于另一次启动的主节点, 序号不可比较, 必须先发快照
+                bool needSnapshot = hello.incarnation != incarnation;
+                // 批次里的字符串跨循环复用, 只覆盖内容, 容量得以保留
+                std::vector<std::string> batch;
+                size_t count = 0;
+                auto nextFrame = [&]() -> std::string &
+                {
+                    if (count == batch.size())
+                        batch.emplace_back();
+                    return batch[count++];
+                };
+                while (true)
+                {
+                    char type = 'R';
+                    bool announce = true;
+                    Heartbeat head;
+                    std::optional<server::Catalog::Snapshot> snapshot;
+                    count = 0;
+                    {
+                        std::unique_lock<std::mutex> lock(logLock);
+                        std::uint64_t last = catalog.read()->version;
+                        if (!needSnapshot && next == last + 1)
+                        {
+                            // 没有新记录, 等一会儿, 超时就只发心跳
+                            announce = !logCV.wait_for(lock, std::chrono::seconds(1), [&]()
+                                                       { return catalog.read()->version >= next; });
+                        }
+                        else if (needSnapshot || next > last + 1 || log.empty() || next < log.front().sequence)
+                        {
+                            // 从节点比主节点新 (主节点重启过) 或者需要的记录已经丢弃, 发快照
+                            // 锁里只拿快照, 编码放到锁外, 不挡住主节点上的写请求
+                            type = 'S';
+                            snapshot.emplace(catalog.read());
+                            next = (*snapshot)->version + 1;
+                            needSnapshot = false;
+                        }
+                        else
+                        {
+                            for (size_t i = next - log.front().sequence; i < log.size(); ++i)
+                                nextFrame() = log[i].payload;
+                            next += count;
+                        }
+                        // 目录只在 logLock 下修改, 这时的 last 就是主节点此刻的最新序号
+                        head = Heartbeat{last, nowMs()};
+                    }
+                    if (snapshot)
+                    {
+                        // 快照里的 Store 不可变, 直接按共享指针编码, 不需要逐个复制
+                        std::string &frame = nextFrame();
+                        frame.clear();
+                        serializer::writeBinary(frame, incarnation);
+                        serializer::writeBinary(frame, (*snapshot)->version);
+                        serializer::writeSnapshot(frame, (*snapshot)->stores);
+                        snapshot.reset();
+                    }
+                    // 从节点只有知道主节点的最新序号, 才能在追赶积压记录时报告真实的延迟
+                    if (announce)
+                    {
+                        payload.clear();
+                        serializer::writeBinary(payload, head);
+                        sendFrame(follower, 'B', payload);
+                    }
+                    for (size_t i = 0; i < count; ++i)
+                        sendFrame(follower, type, batch[i]);
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::cout << "Follower disconnected: " << e.what() << std::endl;
+            }
+            closesocket(follower);
+            --followers;
+        }
+
+        server::Catalog &catalog;
+        const std::uint64_t incarnation;
+        std::mutex logLock;
+        std::condition_variable logCV;
+        std::deque<Entry> log;
+        std::ofstream logFile;
+        std::string record;
+        std::atomic<int> followers{0};
+    };
+
+    // 从节点: 连接主节点并按顺序应用记录, 断线后自动重连
+    class Follower
+    {
+    public:
+        explicit Follower(server::Catalog &catalog) : catalog(catalog) {}
+
+        bool active() const { return running.load(); }
+
+        void follow(const std::string &host, int port)
+        {
+            if (running.exchange(true))
+                return;
+            syncedAt.store(nowMs());
+            std::thread([this, host, port]()
+                        {
+                while (running)
+                {
+                    try
+                    {
+                        session(host, port);
+                    }
+                    catch (const std::exception &e)
+                    {
+                        std::cout << "Replication: " << e.what() << std::endl;
+                    }
+                    connected.store(false);
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
+                } })
+                .detach();
+        }
+
+        Status status()
+        {
+            Status result;
+            result.role = "follower";
+            result.incarnation = incarnation.load();
+            result.connected = connected.load();
+            result.applied = catalog.read()->version;
+            result.primarySequence = std::max(primarySequence.load(), result.applied);
+            result.lagRecords = result.primarySequence - result.applied;
+            // 延迟是目录已知与主节点一致的时间点到现在的时间; 断线期间无法确认, 一直增长
+            if (result.connected && !result.lagRecords)
+                result.lagMs = 0;
+            else
+                result.lagMs = std::max<std::int64_t>(0, nowMs() - syncedAt.load());
+            return result;
+        }
+
+    private:
+        // host 可以是主机名或 IPv4/IPv6 地址, 依次尝试解析出的每个地址
+        SOCKET connectTo(const std::string &host, int port)
+        {
+            struct addrinfo hints = {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_protocol = IPPROTO_TCP;
+            struct addrinfo *addresses = nullptr;
+            int error = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses);
+            if (error != 0)
+            {
+                throw std::runtime_error("Failed to resolve primary " + host + " " + std::to_string(error));
+            }
+            SOCKET primary = -1;
+            int lastError = 0;
+            for (struct addrinfo *address = addresses; address; address = address->ai_next)
+            {
+                primary = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+                if (primary == -1)
+                {
+                    lastError = GetLastError();
+                    continue;
+                }
+                if (connect(primary, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0)
+                    break;
+                lastError = GetLastError();
+                closesocket(primary);
+                primary = -1;
+            }
+            freeaddrinfo(addresses);
+            if (primary == -1)
+            {
+                throw std::runtime_error("Failed to connect to primary " + host + ":" + std::to_string(port) + " " +
+                                         std::to_string(lastError));
+            }
+            return primary;
+        }
+
+        void session(const std::string &host, int port)
+        {
+            SOCKET primary = connectTo(host, port);
+            try
+            {
+                std::string payload;
+                Hello hello{incarnation.load(), catalog.read()->version};
+                serializer::writeBinary(payload, hello);
+                sendFrame(primary, 'H', payload);
+                connected.store(true);
+                std::cout << "Following primary " << host << ":" << port << std::endl;
+
+                while (running)
+                {
+                    char type = recvFrame(primary, payload);
+                    apply(type, payload);
+                }
+            }
+            catch (...)
+            {
+                closesocket(primary);
+                throw;
+            }
+            closesocket(primary);
+        }
+
+        void apply(char type, const std::string &payload)
+        {
+            std::uint64_t applied = catalog.read()->version;
+            if (type == 'S')
+            {
+                serializer::BinaryReader reader(payload);
+                std::uint64_t primaryIncarnation = 0;
+                std::uint64_t version = 0;
+                serializer::readBinary(reader, primaryIncarnation);
+                serializer::readBinary(reader, version);
+                std::vector<server::Store> stores;
+                serializer::readSnapshot(std::string_view(payload).substr(reader.position()), stores);
+                catalog.reset(std::move(stores), version);
+                incarnation.store(primaryIncarnation);
+                primarySequence.store(version);
+                caughtUp(version);
+                std::cout << "Replication snapshot applied at sequence " << version << std::endl;
+            }
+            else if (type == 'R')
+            {
+                Mutation mutation;
+                serializer::readBinary(payload, mutation);
+                if (mutation.sequence <= applied)
+                    return;
+                if (mutation.sequence != applied + 1)
+                {
+                    // 断开重连, 主节点会根据已应用的序号补发或者发快照
+                    throw std::runtime_error("Replication gap at sequence " + std::to_string(applied + 1));
+                }
+                // 下一条记录产生之前, 主节点的目录与本地已应用的版本相同
+                if (mutation.timestamp > syncedAt.load())
+                    syncedAt.store(mutation.timestamp);
+                if (mutation.type == static_cast<int>(MutationType::AddStore))
+                    catalog.addStore(std::move(mutation.store));
+                else
+                    catalog.replaceStore(mutation.index, std::move(mutation.store));
+                caughtUp(mutation.sequence);
+            }
+            else if (type == 'B')
+            {
+                serializer::readBinary(payload, head);
+                if (head.sequence > primarySequence.load())
+                    primarySequence.store(head.sequence);
+                caughtUp(applied);
+            }
+            else
+            {
+                throw std::runtime_error("Unknown replication frame");
+            }
+        }
+
+        // 已经应用到最近一次 'B' 报告的序号时, 目录与主节点发出 'B' 时的状态一致
+        void caughtUp(std::uint64_t applied)
+        {
+            if (applied >= head.sequence && head.timestamp > syncedAt.load())
+                syncedAt.store(head.timestamp);
+        }
+
+        server::Catalog &catalog;
+        std::atomic<bool> running{false};
+        std::atomic<bool> connected{false};
+        std::atomic<std::uint64_t> incarnation{0};
+        std::atomic<std::uint64_t> primarySequence{0};
+        std::atomic<std::int64_t> syncedAt{0}; // 主节点时钟, 毫秒; 还没同步过时是开始跟随的时间
+        Heartbeat head; // 最近一次 'B', 只在复制线程里访问
+    };
+}
+
+#endif
@@ -0,0 +1,672 @@
+#ifndef SERIALIZER_HPP_
+#define SERIALIZER_HPP_
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// 编译期字段描述 + JSON / 二进制编解码
+//
+// 一个类型只要在自己的命名空间里提供
+//     constexpr auto describe(const T *)
+// 返回 serializer::field(...) 组成的 tuple, 就可以被下面所有编码器使用.
+// describe 通过 ADL 查找, 所以不需要离开业务代码所在的命名空间.
+//
+// 所有 write* 函数都只向调用者传入的 std::string 追加数据, 调用者 clear()
+// 之后复用同一个缓冲区, 容量稳定后不会再分配内存.
+// read* 函数解码到已有对象时原地覆盖 (数组按新长度 resize), 同样可以复用;
+// 注意 JSON 里没有出现的字段会保留旧值.
+namespace serializer
+{
+    template <class Owner, class T>
+    struct Field
+    {
+        std::string_view name;
+        T Owner::*member;
+        bool onWire; // false 时 writeWire 不输出该字段, 快照和日志照常包含
+    };
+
+    template <class Owner, class T>
+    constexpr Field<Owner, T> field(std::string_view name, T Owner::*member)
+    {
+        return Field<Owner, T>{name, member, true};
+    }
+
+    // 只在进程内部和节点之间使用的字段 (例如密码), 不会出现在响应体里
+    template <class Owner, class T>
+    constexpr Field<Owner, T> internalField(std::string_view name, T Owner::*member)
+    {
+        return Field<Owner, T>{name, member, false};
+    }
+
+    template <class T, class = void>
+    struct isDescribed : std::false_type
+    {
+    };
+
+    template <class T>
+    struct isDescribed<T, std::void_t<decltype(describe(static_cast<const T *>(nullptr)))>> : std::true_type
+    {
+    };
+
+    template <class T>
+    struct isVector : std::false_type
+    {
+    };
+
+    template <class T, class A>
+    struct isVector<std::vector<T, A>> : std::true_type
+    {
+    };
+
+    template <class T>
+    struct isSharedPtr : std::false_type
+    {
+    };
+
+    template <class T>
+    struct isSharedPtr<std::shared_ptr<T>> : std::true_type
+    {
+    };
+
+    template <class T>
+    constexpr auto fieldsOf()
+    {
+        return describe(static_cast<const T *>(nullptr));
+    }
+
+    template <class Tuple, class F>
+    constexpr void forEachField(const Tuple &fields, F &&f)
+    {
+        std::apply([&f](const auto &...each)
+                   { (f(each), ...); },
+                   fields);
+    }
+
+    // ------------------------------------------------------------------
+    // JSON 字符串转义
+    // ------------------------------------------------------------------
+
+    // 一次检查 8 个字节 (SWAR), 只有命中 '"' '\\' 或控制字符时才逐字节处理,
+    // 普通文本整段拷贝.
+    inline bool wordNeedsEscape(std::uint64_t word)
+    {
+        constexpr std::uint64_t ones = 0x0101010101010101ULL;
+        constexpr std::uint64_t highs = 0x8080808080808080ULL;
+        std::uint64_t quote = word ^ (ones * '"');
+        std::uint64_t slash = word ^ (ones * '\\');
+        std::uint64_t hasQuote = (quote - ones) & ~quote;
+        std::uint64_t hasSlash = (slash - ones) & ~slash;
+        std::uint64_t hasControl = (word - ones * 0x20) & ~word;
+        return ((hasQuote | hasSlash | hasControl) & highs) != 0;
+    }
+
+    inline void appendEscaped(std::string &out, std::string_view s)
+    {
+        static const char hex[] = "0123456789abcdef";
+        const char *data = s.data();
+        size_t len = s.size();
+        size_t runStart = 0;
+        size_t pos = 0;
+        out.push_back('"');
+        while (pos < len)
+        {
+            if (pos + 8 <= len)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, data + pos, 8);
+                if (!wordNeedsEscape(word))
+                {
+                    pos += 8;
+                    continue;
+                }
+            }
+            unsigned char c = static_cast<unsigned char>(data[pos]);
+            if (c != '"' && c != '\\' && c >= 0x20)
+            {
+                ++pos;
+                continue;
+            }
+            out.append(data + runStart, pos - runStart);
+            out.push_back('\\');
+            switch (c)
+            {
+            case '"':
+                out.push_back('"');
+                break;
+            case '\\':
+                out.push_back('\\');
+                break;
+            case '\n':
+                out.push_back('n');
+                break;
+            case '\r':
+                out.push_back('r');
+                break;
+            case '\t':
+                out.push_back('t');
+                break;
+            case '\b':
+                out.push_back('b');
+                break;
+            case '\f':
+                out.push_back('f');
+                break;
+            default:
+                out.append("u00", 3);
+                out.push_back(hex[c >> 4]);
+                out.push_back(hex[c & 0x0f]);
+                break;
+            }
+            runStart = ++pos;
+        }
+        out.append(data + runStart, len - runStart);
+        out.push_back('"');
+    }
+
+    // ------------------------------------------------------------------
+    // JSON 编码
+    // ------------------------------------------------------------------
+
+    // wireOnly 为 true 时跳过 internalField 声明的字段
+    template <class T>
+    void writeJson(std::string &out, const T &value, bool wireOnly = false)
+    {
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            if (value)
+                out.append("true", 4);
+            else
+                out.append("false", 5);
+        }
+        else if constexpr (std::is_integral_v<T>)
+        {
+            char digits[24];
+            auto result = std::to_chars(digits, digits + sizeof(digits), value);
+            out.append(digits, result.ptr - digits);
+        }
+        else if constexpr (std::is_same_v<T, std::string>)
+        {
+            appendEscaped(out, value);
+        }
+        else if constexpr (isVector<T>::value)
+        {
+            out.push_back('[');
+            bool first = true;
+            for (const auto &item : value)
+            {
+                if (!first)
+                    out.push_back(',');
+                first = false;
+                writeJson(out, item, wireOnly);
+            }
+            out.push_back(']');
+        }
+        else
+        {
+            static_assert(isDescribed<T>::value, "type has no describe() overload");
+            out.push_back('{');
+            bool first = true;
+            forEachField(fieldsOf<T>(), [&](const auto &f)
+                         {
+                if (wireOnly && !f.onWire)
+                    return;
+                if (!first)
+                    out.push_back(',');
+                first = false;
+                out.push_back('"');
+                out.append(f.name.data(), f.name.size());
+                out.append("\":", 2);
+                writeJson(out, value.*(f.member), wireOnly); });
+            out.push_back('}');
+        }
+    }
+
+    // ------------------------------------------------------------------
+    // JSON 解码
+    // ------------------------------------------------------------------
+
+    class JsonReader
+    {
+    public:
+        explicit JsonReader(std::string_view input) : in(input) {}
+
+        size_t position() const { return pos; }
+
+        void skipSpace()
+        {
+            while (pos < in.size() && (in[pos] == ' ' || in[pos] == '\n' || in[pos] == '\r' || in[pos] == '\t'))
+                ++pos;
+        }
+
+        bool consume(char c)
+        {
+            skipSpace();
+            if (pos < in.size() && in[pos] == c)
+            {
+                ++pos;
+                return true;
+            }
+            return false;
+        }
+
+        void expect(char c)
+        {
+            if (!consume(c))
+                throw std::runtime_error("Malformed JSON");
+        }
+
+        template <class T>
+        void readInteger(T &value)
+        {
+            skipSpace();
+            auto result = std::from_chars(in.data() + pos, in.data() + in.size(), value);
+            if (result.ec != std::errc())
+                throw std::runtime_error("Malformed JSON number");
+            pos = result.ptr - in.data();
+        }
+
+        void readString(std::string &value)
+        {
+            expect('"');
+            value.clear();
+            while (true)
+            {
+                size_t end = in.find_first_of("\"\\", pos);
+                if (end == std::string_view::npos)
+                    throw std::runtime_error("Unterminated JSON string");
+                value.append(in.data() + pos, end - pos);
+                pos = end + 1;
+                if (in[end] == '"')
+                    return;
+                if (pos >= in.size())
+                    throw std::runtime_error("Unterminated JSON string");
+                char c = in[pos++];
+                switch (c)
+                {
+                case 'n':
+                    value.push_back('\n');
+                    break;
+                case 'r':
+                    value.push_back('\r');
+                    break;
+                case 't':
+                    value.push_back('\t');
+                    break;
+                case 'b':
+                    value.push_back('\b');
+                    break;
+                case 'f':
+                    value.push_back('\f');
+                    break;
+                case 'u':
+                    appendCodePoint(value, readCodePoint());
+                    break;
+                default:
+                    value.push_back(c);
+                    break;
+                }
+            }
+        }
+
+        // 跳过一个不认识的值 (字段多出来时保持向前兼容)
+        void skipValue()
+        {
+            skipSpace();
+            if (pos >= in.size())
+                throw std::runtime_error("Malformed JSON");
+            char c = in[pos];
+            if (c == '"')
+            {
+                std::string ignored;
+                readString(ignored);
+            }
+            else if (c == '{' || c == '[')
+            {
+                char close = c == '{' ? '}' : ']';
+                ++pos;
+                if (consume(close))
+                    return;
+                do
+                {
+                    if (close == '}')
+                    {
+                        std::string ignored;
+                        readString(ignored);
+                        expect(':');
+                    }
+                    skipValue();
+                } while (consume(','));
+                expect(close);
+            }
+            else
+            {
+                while (pos < in.size() && in[pos] != ',' && in[pos] != '}' && in[pos] != ']' &&
+                       in[pos] != ' ' && in[pos] != '\n' && in[pos] != '\r' && in[pos] != '\t')
+                    ++pos;
+            }
+        }
+
+    private:
+        unsigned readHex4()
+        {
+            if (pos + 4 > in.size())
+                throw std::runtime_error("Malformed JSON escape");
+            unsigned code = 0;
+            auto result = std::from_chars(in.data() + pos, in.data() + pos + 4, code, 16);
+            if (result.ptr != in.data() + pos + 4)
+                throw std::runtime_error("Malformed JSON escape");
+            pos += 4;
+            return code;
+        }
+
+        // \u 之后的码点, UTF-16 代理对合并成一个码点, 落单的代理项视为错误
+        unsigned readCodePoint()
+        {
+            unsigned code = readHex4();
+            if (code >= 0xdc00 && code <= 0xdfff)
+                throw std::runtime_error("Unpaired JSON surrogate");
+            if (code >= 0xd800 && code <= 0xdbff)
+            {
+                if (pos + 2 > in.size() || in[pos] != '\\' || in[pos + 1] != 'u')
+                    throw std::runtime_error("Unpaired JSON surrogate");
+                pos += 2;
+                unsigned low = readHex4();
+                if (low < 0xdc00 || low > 0xdfff)
+                    throw std::runtime_error("Unpaired JSON surrogate");
+                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+            }
+            return code;
+        }
+
+        static void appendCodePoint(std::string &out, unsigned code)
+        {
+            if (code < 0x80)
+                out.push_back(static_cast<char>(code));
+            else if (code < 0x800)
+            {
+                out.push_back(static_cast<char>(0xc0 | (code >> 6)));
+                out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+            }
+            else if (code < 0x10000)
+            {
+                out.push_back(static_cast<char>(0xe0 | (code >> 12)));
+                out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+                out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+            }
+            else
+            {
+                out.push_back(static_cast<char>(0xf0 | (code >> 18)));
+                out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+                out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+                out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+            }
+        }
+
+        std::string_view in;
+        size_t pos = 0;
+    };
+
+    template <class T>
+    void readJson(JsonReader &reader, T &value)
+    {
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            if (reader.consume('t'))
+            {
+                reader.expect('r'), reader.expect('u'), reader.expect('e');
+                value = true;
+            }
+            else
+            {
+                reader.expect('f'), reader.expect('a'), reader.expect('l'), reader.expect('s'), reader.expect('e');
+                value = false;
+            }
+        }
+        else if constexpr (std::is_integral_v<T>)
+        {
+            reader.readInteger(value);
+        }
+        else if constexpr (std::is_same_v<T, std::string>)
+        {
+            reader.readString(value);
+        }
+        else if constexpr (isVector<T>::value)
+        {
+            // 复用已有元素, 只覆盖内容, 字符串的容量得以保留
+            reader.expect('[');
+            size_t count = 0;
+            if (!reader.consume(']'))
+            {
+                do
+                {
+                    if (count == value.size())
+                        value.emplace_back();
+                    readJson(reader, value[count++]);
+                } while (reader.consume(','));
+                reader.expect(']');
+            }
+            value.resize(count);
+        }
+        else
+        {
+            static_assert(isDescribed<T>::value, "type has no describe() overload");
+            reader.expect('{');
+            if (reader.consume('}'))
+                return;
+            std::string key;
+            do
+            {
+                reader.readString(key);
+                reader.expect(':');
+                bool matched = false;
+                forEachField(fieldsOf<T>(), [&](const auto &f)
+                             {
+                    if (!matched && f.name == key)
+                    {
+                        readJson(reader, value.*(f.member));
+                        matched = true;
+                    } });
+                if (!matched)
+                    reader.skipValue();
+            } while (reader.consume(','));
+            reader.expect('}');
+        }
+    }
+
+    template <class T>
+    void readJson(std::string_view input, T &value)
+    {
+        JsonReader reader(input);
+        readJson(reader, value);
+    }
+
+    // ------------------------------------------------------------------
+    // 二进制编码: 整数用 varint (有符号先 zigzag), 字符串和数组带长度前缀,
+    // 结构体按 describe() 中的字段顺序依次写出.
+    // ------------------------------------------------------------------
+
+    inline void writeVarint(std::string &out, std::uint64_t v)
+    {
+        char bytes[10];
+        int n = 0;
+        while (v >= 0x80)
+        {
+            bytes[n++] = static_cast<char>((v & 0x7f) | 0x80);
+            v >>= 7;
+        }
+        bytes[n++] = static_cast<char>(v);
+        out.append(bytes, n);
+    }
+
+    template <class T>
+    void writeBinary(std::string &out, const T &value)
+    {
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            out.push_back(value ? 1 : 0);
+        }
+        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+        {
+            std::int64_t v = value;
+            writeVarint(out, (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63));
+        }
+        else if constexpr (std::is_integral_v<T>)
+        {
+            writeVarint(out, value);
+        }
+        else if constexpr (std::is_same_v<T, std::string>)
+        {
+            writeVarint(out, value.size());
+            out.append(value);
+        }
+        else if constexpr (isVector<T>::value)
+        {
+            writeVarint(out, value.size());
+            for (const auto &item : value)
+                writeBinary(out, item);
+        }
+        else if constexpr (isSharedPtr<T>::value)
+        {
+            // 按指向的对象编码, 和直接存对象的容器编码结果相同
+            writeBinary(out, *value);
+        }
+        else
+        {
+            static_assert(isDescribed<T>::value, "type has no describe() overload");
+            forEachField(fieldsOf<T>(), [&](const auto &f)
+                         { writeBinary(out, value.*(f.member)); });
+        }
+    }
+
+    class BinaryReader
+    {
+    public:
+        explicit BinaryReader(std::string_view input) : in(input) {}
+
+        size_t position() const { return pos; }
+        bool atEnd() const { return pos == in.size(); }
+        size_t remaining() const { return in.size() - pos; }
+
+        std::uint64_t readVarint()
+        {
+            std::uint64_t v = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                if (pos >= in.size())
+                    throw std::runtime_error("Truncated binary record");
+                unsigned char byte = static_cast<unsigned char>(in[pos++]);
+                v |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+                if (!(byte & 0x80))
+                    return v;
+            }
+            throw std::runtime_error("Malformed varint");
+        }
+
+        std::string_view readBytes(size_t n)
+        {
+            if (n > in.size() - pos)
+                throw std::runtime_error("Truncated binary record");
+            std::string_view bytes = in.substr(pos, n);
+            pos += n;
+            return bytes;
+        }
+
+    private:
+        std::string_view in;
+        size_t pos = 0;
+    };
+
+    template <class T>
+    void readBinary(BinaryReader &reader, T &value)
+    {
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            value = reader.readBytes(1)[0] != 0;
+        }
+        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+        {
+            std::uint64_t v = reader.readVarint();
+            value = static_cast<T>(static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1));
+        }
+        else if constexpr (std::is_integral_v<T>)
+        {
+            value = static_cast<T>(reader.readVarint());
+        }
+        else if constexpr (std::is_same_v<T, std::string>)
+        {
+            std::string_view bytes = reader.readBytes(reader.readVarint());
+            value.assign(bytes.data(), bytes.size());
+        }
+        else if constexpr (isVector<T>::value)
+        {
+            // 每个元素至少占一个字节, 元素个数不可能超过剩余字节数
+            std::uint64_t n = reader.readVarint();
+            if (n > reader.remaining())
+                throw std::runtime_error("Truncated binary record");
+            value.resize(n);
+            for (auto &item : value)
+                readBinary(reader, item);
+        }
+        else
+        {
+            static_assert(isDescribed<T>::value, "type has no describe() overload");
+            forEachField(fieldsOf<T>(), [&](const auto &f)
+                         { readBinary(reader, value.*(f.member)); });
+        }
+    }
+
+    template <class T>
+    void readBinary(std::string_view input, T &value)
+    {
+        BinaryReader reader(input);
+        readBinary(reader, value);
+    }
+
+    // ------------------------------------------------------------------
+    // 三种用途共用同一套描述:
+    //   wire     -> JSON 响应体, 不含 internalField
+    //   snapshot -> 带魔数的二进制整表
+    //   log      -> 每条记录一行 JSON, 以 '\n' 结尾 (不 flush)
+    // ------------------------------------------------------------------
+
+    constexpr std::string_view snapshotMagic = "MSNP1";
+
+    template <class T>
+    void writeWire(std::string &out, const T &value)
+    {
+        writeJson(out, value, true);
+    }
+
+    template <class T>
+    void writeSnapshot(std::string &out, const T &value)
+    {
+        out.append(snapshotMagic.data(), snapshotMagic.size());
+        writeBinary(out, value);
+    }
+
+    template <class T>
+    void readSnapshot(std::string_view input, T &value)
+    {
+        if (input.substr(0, snapshotMagic.size()) != snapshotMagic)
+            throw std::runtime_error("Not a snapshot");
+        readBinary(input.substr(snapshotMagic.size()), value);
+    }
+
+    template <class T>
+    void writeLogRecord(std::string &out, const T &value)
+    {
+        writeJson(out, value);
+        out.push_back('\n');
+    }
+}
+
+#endif
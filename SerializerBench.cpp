@@ -0,0 +1,92 @@
+// 序列化吞吐量测试
+// g++ -std=gnu++17 -O2 SerializerBench.cpp -o SerializerBench
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Store.hpp"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static vector<server::Store> makeStores(int storeAmount, int dishAmount)
+{
+    vector<server::Store> result;
+    for (int i = 0; i < storeAmount; ++i)
+    {
+        server::Store store;
+        store.name = "Store \"" + to_string(i) + "\" noodles & rice";
+        store.address = "No." + to_string(i) + " Long Street, District\\Area";
+        store.bindPassword = "password" + to_string(i);
+        store.phoneNum = "1380000" + to_string(1000 + i);
+        store.customerAmount = i * 37;
+        for (int j = 0; j < dishAmount; ++j)
+            store.dishes.push_back(server::Dish{"Dish number " + to_string(j) + " with a longer descriptive name",
+                                                100 + j, "bowl", static_cast<unsigned long>(i * 1000 + j)});
+        result.push_back(store);
+    }
+    return result;
+}
+
+template <class F>
+static void measure(const string &name, int rounds, F &&f)
+{
+    size_t bytes = 0;
+    f(bytes); // warm up, 让缓冲区容量稳定
+    bytes = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < rounds; ++i)
+        f(bytes);
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+    cout << name << ": " << rounds / seconds << " ops/s, "
+         << bytes / seconds / (1024 * 1024) << " MiB/s" << endl;
+}
+
+int main()
+{
+    vector<server::Store> stores = makeStores(200, 20);
+    const int rounds = 200;
+    string buffer;
+    server::Store decodedStore;
+    vector<server::Store> decoded;
+
+    measure("json encode", rounds, [&](size_t &bytes)
+            {
+        buffer.clear();
+        serializer::writeWire(buffer, stores);
+        bytes += buffer.size(); });
+
+    string json;
+    serializer::writeWire(json, stores);
+    measure("json decode", rounds, [&](size_t &bytes)
+            {
+        serializer::readJson(json, decoded);
+        bytes += json.size(); });
+
+    measure("binary encode", rounds, [&](size_t &bytes)
+            {
+        buffer.clear();
+        serializer::writeSnapshot(buffer, stores);
+        bytes += buffer.size(); });
+
+    string snapshot;
+    serializer::writeSnapshot(snapshot, stores);
+    measure("binary decode", rounds, [&](size_t &bytes)
+            {
+        serializer::readSnapshot(snapshot, decoded);
+        bytes += snapshot.size(); });
+
+    measure("log record", rounds * 200, [&](size_t &bytes)
+            {
+        buffer.clear();
+        serializer::writeLogRecord(buffer, stores[bytes % stores.size()]);
+        bytes += buffer.size(); });
+
+    serializer::readJson(json, decoded);
+    bool same = decoded.size() == stores.size() && decoded.back().dishes.back().name == stores.back().dishes.back().name &&
+                decoded.back().name == stores.back().name;
+    serializer::readSnapshot(snapshot, decoded);
+    same = same && decoded.back().address == stores.back().address;
+    cout << "round trip " << (same ? "ok" : "FAILED") << endl;
+    return same ? 0 : 1;
+}
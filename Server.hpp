@@ -11,7 +11,13 @@
 #include <sstream>
 #include <map>
 #include <fstream>
+#include <chrono>
+#include <cstdlib>
 #include "ThreadPool.hpp"
+#include "Store.hpp"
+#include "Catalog.hpp"
+#include "Replication.hpp"
+#include "TimerWheel.hpp"
 // Windows only
 #ifdef _WIN32
 #include <winsock2.h>
@@ -22,33 +28,112 @@
 
 namespace server
 {
-    struct Dish
+    enum class Option
     {
-        std::string name;
-        int price;
-        std::string unit;
-        unsigned long imageBinary;
+        CreateStoreFile,
+        GetStores,
+        ReplicationStatus
     };
-    struct Store
-    {
-        std::string name;
-        std::string address;
-        std::string bindPassword;
-        std::string phoneNum;
-        int customerAmount = 0;
-        std::vector<Dish> dishes;
+
+    std::map<std::string, Option> options = {
+        {"/CreateStoreFile", Option::CreateStoreFile},
+        {"/GetStores", Option::GetStores},
+        {"/ReplicationStatus", Option::ReplicationStatus}};
+
+    // 每条路由交给哪个执行器, 以什么优先级运行
+    struct Route
+    {
+        std::string executor;
+        ThreadPool::Priority priority;
     };
 
-    enum class Option
+    // 读请求通过 stores.read() 拿到不可变快照, 不需要加锁
+    Catalog stores;
+    // interactive 处理收包和轻量读请求, background 处理写文件等慢任务,
+    // 两者线程互相独立, 慢任务堆积不会拖慢交互请求
+    ThreadPool::ThreadPool &pool = ThreadPool::Executors::create("interactive", 4);
+    ThreadPool::ThreadPool &background = ThreadPool::Executors::create("background", 2);
+    // connections 负责阻塞读取请求, 每个慢客户端最多占用其中一个线程到读超时为止
+    ThreadPool::ThreadPool &connections = ThreadPool::Executors::create("connections", 32);
+
+    std::map<Option, Route> routes = {
+        {Option::CreateStoreFile, {"background", ThreadPool::Priority::Low}},
+        {Option::GetStores, {"interactive", ThreadPool::Priority::High}},
+        {Option::ReplicationStatus, {"interactive", ThreadPool::Priority::High}}};
+
+    // 写操作都经过 primary 以便记录复制日志; follower 启动后本进程只读
+    replication::Primary primary(stores);
+    replication::Follower follower(stores);
+
+    // 连接各阶段的超时时间
+    struct Timeouts
     {
-        CreateStoreFile
+        std::chrono::milliseconds idle{5000};        // 连接建立后等待第一个字节
+        std::chrono::milliseconds headerRead{10000}; // 收到第一个字节后读完请求头
+        std::chrono::milliseconds bodyRead{30000};   // 读完 Content-Length 指定的请求体
+        std::chrono::milliseconds handler{30000};    // 路由处理函数
     };
 
-    std::map<std::string, Option> options = {
-        {"/CreateStoreFile", Option::CreateStoreFile}};
+    Timeouts timeouts;
+    TimerWheel::TimerWheel timers;
+
+    // 连接某个阶段的超时, 到期后关闭连接的读写, 阻塞在 recv 上的线程会立即返回.
+    // 离开作用域时自动取消.
+    class Deadline
+    {
+    public:
+        Deadline(SOCKET client_socket, std::chrono::milliseconds timeout, const char *stage)
+            : id(timers.schedule(timeout, [client_socket, stage]()
+                                 {
+                std::cout << stage << " timeout, closing connection" << std::endl;
+                shutdown(client_socket, SD_BOTH); }))
+        {
+        }
+
+        ~Deadline() { cancel(); }
+
+        // 返回 false 表示已经超时
+        bool cancel()
+        {
+            if (!cancelled)
+            {
+                cancelled = true;
+                inTime = timers.cancel(id);
+            }
+            return inTime;
+        }
+
+    private:
+        TimerWheel::TimerId id;
+        bool cancelled = false;
+        bool inTime = true;
+    };
+
+    // 客户端造成的错误, status 作为响应状态行返回; 其它异常一律返回 500
+    class RequestError : public std::runtime_error
+    {
+    public:
+        RequestError(const char *status, const std::string &message) : std::runtime_error(message), status(status) {}
+
+        const char *status;
+    };
 
-    std::vector<Store> stores;
-    ThreadPool::ThreadPool pool = ThreadPool::ThreadPool::getInstance();
+    // 持有客户端 socket, 最后一个持有者析构时关闭, 异常路径也不会泄漏.
+    // 使用 socket 的 Deadline 都比 Connection 先析构, 关闭时不会再有超时回调.
+    class Connection
+    {
+    public:
+        explicit Connection(SOCKET client_socket) : client_socket(client_socket) {}
+        ~Connection() { closesocket(client_socket); }
+
+        Connection(const Connection &) = delete;
+        Connection &operator=(const Connection &) = delete;
+
+        SOCKET socket() const { return client_socket; }
+
+    private:
+        SOCKET client_socket;
+    };
 
 #if __cplusplus >= 201703L
 #include <string_view>
@@ -398,6 +483,8 @@ namespace server
             std::cout << "Server is listening on port " + ss.str() << std::endl;
         }
 
+        timers.start();
+
         std::cout << std::endl
                   << "Server init succesfully" << std::endl;
         return server_socket;
@@ -423,19 +510,61 @@ namespace server
     std::shared_ptr<char[]> getRequest(SOCKET client_socket)
     {
         // Make request
-        std::future<std::shared_ptr<char[]>> taskFuture = pool.addTask("getRequest", [](SOCKET client_socket)
-                                                                       {
-            std::shared_ptr<char[]> buffer(new char[BUFFER_SIZE]);
-            int data = recv(client_socket, buffer.get(), BUFFER_SIZE, 0);
-            if (data == -1)
+        // 在连接线程上直接读, 各阶段由 Deadline 限时
+        std::shared_ptr<char[]> buffer(new char[BUFFER_SIZE]);
+        int received = 0;
+        int data = 0;
+        {
+            Deadline idle(client_socket, timeouts.idle, "Idle");
+            data = recv(client_socket, buffer.get(), BUFFER_SIZE - 1, 0);
+            if (!idle.cancel())
+                throw RequestError("408 Request Timeout", "Idle timeout");
+        }
+        if (data <= 0)
+            throw std::runtime_error("Failed to receive request " + std::to_string(GetLastError()));
+        received = data;
+        buffer[received] = '\0';
+
+        // 请求头: 读到空行为止
+        {
+            Deadline header(client_socket, timeouts.headerRead, "Header read");
+            while (!strstr(buffer.get(), "\r\n\r\n") && received < BUFFER_SIZE - 1)
             {
-                std::cout << "Failed to receive request " << GetLastError() << std::endl;
-                exit(-1);
+                data = recv(client_socket, buffer.get() + received, BUFFER_SIZE - 1 - received, 0);
+                if (data <= 0)
+                {
+                    if (!header.cancel())
+                        throw RequestError("408 Request Timeout", "Header read timeout");
+                    throw std::runtime_error("Failed to receive request " + std::to_string(GetLastError()));
+                }
+                received += data;
+                buffer[received] = '\0';
             }
-            else
-                std::cout << "Request received successfully" << std::endl;
-            return std::move(buffer); }, client_socket);
-        return taskFuture.get();
+        }
+
+        // 请求体: 按 Content-Length 读完
+        char *headerEnd = strstr(buffer.get(), "\r\n\r\n");
+        char *contentLength = strstr(buffer.get(), "Content-Length:");
+        if (headerEnd && contentLength && contentLength < headerEnd)
+        {
+            int bodyStart = headerEnd + 4 - buffer.get();
+            int bodyLength = atoi(contentLength + strlen("Content-Length:"));
+            Deadline body(client_socket, timeouts.bodyRead, "Body read");
+            while (received - bodyStart < bodyLength && received < BUFFER_SIZE - 1)
+            {
+                data = recv(client_socket, buffer.get() + received, BUFFER_SIZE - 1 - received, 0);
+                if (data <= 0)
+                {
+                    if (!body.cancel())
+                        throw RequestError("408 Request Timeout", "Body read timeout");
+                    throw std::runtime_error("Failed to receive request " + std::to_string(GetLastError()));
+                }
+                received += data;
+                buffer[received] = '\0';
+            }
+        }
+        std::cout << "Request received successfully" << std::endl;
+        return buffer;
     }
 
     char *findFirst(std::shared_ptr<char[]> *buffer_ptr, int toFind)
@@ -446,13 +575,18 @@ namespace server
     std::string getUrl(std::shared_ptr<char[]> buffer)
     {
         // Make url
-        std::future<std::string> taskFuture = pool.addTask("getUrl", [](std::shared_ptr<char[]> buffer)
-                                                           {
-            char *url_start = findFirst(&buffer, ' ') + 1;
-            char *url_end = strchr(url_start, '?');
-            std::string url(url_start, url_end - url_start);
-            return url; }, std::move(buffer));
-        return taskFuture.get();
+        char *method_end = findFirst(&buffer, ' ');
+        if (!method_end)
+        {
+            throw RequestError("400 Bad Request", "Malformed request");
+        }
+        char *url_start = method_end + 1;
+        char *url_end = strpbrk(url_start, "? ");
+        if (!url_end)
+        {
+            throw RequestError("400 Bad Request", "Malformed request");
+        }
+        return std::string(url_start, url_end - url_start);
     }
 
     std::string getPath(std::string url)
@@ -470,7 +604,7 @@ namespace server
         }
         else
         {
-            throw std::runtime_error("Option not found");
+            throw RequestError("404 Not Found", "Option not found");
         }
     }
 
@@ -521,49 +655,164 @@ namespace server
         }
         else
         {
-            throw std::runtime_error("Parameters not found");
+            throw RequestError("400 Bad Request", "Parameters not found");
+        }
+    }
+
+    void sendResponse(SOCKET client_socket, const std::string &status, const std::string &body)
+    {
+        thread_local std::string response;
+        response.clear();
+        response.append("HTTP/1.1 ");
+        response.append(status);
+        response.append("\r\nContent-Type: application/json\r\nContent-Length: ");
+        response.append(std::to_string(body.size()));
+        response.append("\r\nConnection: close\r\n\r\n");
+        response.append(body);
+        size_t sent = 0;
+        while (sent < response.size())
+        {
+            int data = send(client_socket, response.data() + sent, static_cast<int>(response.size() - sent), 0);
+            if (data <= 0)
+            {
+                throw std::runtime_error("Failed to send response " + std::to_string(GetLastError()));
+            }
+            sent += data;
+        }
+    }
+
+    // 把异常转换成错误响应; 连接可能已经被超时关闭, 发送失败只记录日志
+    void sendError(SOCKET client_socket, const std::exception &e)
+    {
+        std::cout << "Request failed: " << e.what() << std::endl;
+        const RequestError *requestError = dynamic_cast<const RequestError *>(&e);
+        std::string body = "{\"error\":";
+        serializer::appendEscaped(body, e.what());
+        body.push_back('}');
+        try
+        {
+            sendResponse(client_socket, requestError ? requestError->status : "500 Internal Server Error", body);
+        }
+        catch (const std::exception &sendFailure)
+        {
+            std::cout << sendFailure.what() << std::endl;
+        }
+    }
+
+    std::string getStores(std::string)
+    {
+        std::string body;
+        body.push_back('[');
+        {
+            // 快照只在拼装响应体期间持有, 发送之前就释放, 慢客户端不会拖住旧版本的回收
+            auto snapshot = stores.read();
+            for (size_t i = 0; i < snapshot->stores.size(); i++)
+            {
+                if (i)
+                    body.push_back(',');
+                serializer::writeWire(body, *snapshot->stores[i]);
+            }
         }
+        body.push_back(']');
+        return body;
     }
 
-    void createStoreFile(std::string url)
+    std::string replicationStatus(std::string)
     {
+        replication::Status status = follower.active() ? follower.status() : primary.status();
+        std::string body;
+        serializer::writeWire(body, status);
+        return body;
+    }
+
+    std::string createStoreFile(std::string url)
+    {
+        if (follower.active())
+        {
+            throw RequestError("403 Forbidden", "Read-only replica");
+        }
         std::vector<std::vector<std::string>> parameters = getParameters(url);
-        std::ofstream storesList("storesList.txt", std::ios::app | std::ios::binary);
-        if (!storesList)
+        std::vector<std::string> params = {"name", "address", "bindPassword", "phoneNum"};
+        if (parameters.size() > params.size())
         {
-            throw std::runtime_error("Failed to open storesList.txt");
+            throw RequestError("400 Bad Request", "Parameters not found");
         }
-        else
+        Store store;
+        std::string *fields[] = {&store.name, &store.address, &store.bindPassword, &store.phoneNum};
+        for (int i = 0; i < parameters.size(); i++)
         {
-            std::vector<std::string> params = {"name", "address", "bindPassword", "phoneNum"};
-            storesList << "{" << std::endl;
-            for (int i = 0; i < parameters.size(); i++)
+            if (parameters[i][0] != params[i])
             {
-                if (parameters[i][0] != params[i])
+                throw RequestError("400 Bad Request", "Parameters not found");
+            }
+            *fields[i] = parameters[i][1];
+        }
+
+        // 落盘和分配版本号都在 primary 的锁里完成, 文件中的顺序就是目录的版本顺序
+        std::uint64_t version = primary.addStore(std::move(store));
+        return "{\"version\":" + std::to_string(version) + "}";
+    }
+
+    // 在路由指定的执行器上运行处理函数, 出错只影响当前请求
+    void Handle(std::shared_ptr<Connection> connection, Option option, std::string request)
+    {
+        SOCKET client_socket = connection->socket();
+        try
+        {
+            std::string body;
+            {
+                // 处理函数无法被中途打断: 超时后连接被关闭, 结果也不再发送
+                Deadline handler(client_socket, timeouts.handler, "Handler");
+                switch (option)
+                {
+                case Option::CreateStoreFile:
+                    body = createStoreFile(request);
+                    break;
+                case Option::GetStores:
+                    body = getStores(request);
+                    break;
+                case Option::ReplicationStatus:
+                    body = replicationStatus(request);
+                    break;
+                default:
+                    throw RequestError("404 Not Found", "Option not found");
+                    break;
+                }
+                if (!handler.cancel())
                 {
-                    throw std::runtime_error("Parameters not found");
+                    throw std::runtime_error("Handler deadline exceeded");
                 }
             }
-            for (int i = 0; i < parameters.size(); i++) storesList<<parameters[i][0]+":"<<parameters[i][1]<<std::endl;
-            storesList << "}" << std::endl;
+            sendResponse(client_socket, "200 OK", body);
+        }
+        catch (const std::exception &e)
+        {
+            sendError(client_socket, e);
         }
-        storesList.close();
     }
 
-    void Execute(SOCKET client_socket)
+    // 在 connections 执行器上读请求, 然后交给路由对应的执行器
+    void Execute(std::shared_ptr<Connection> connection)
     {
-        std::shared_ptr<char[]> request = getRequest(client_socket);
-        std::string url = getUrl(request);
-        Option option = getOption(url);
-        switch (option)
+        try
         {
-        case Option::CreateStoreFile:
-            createStoreFile(request.get());
-            break;
-        default:
-            throw std::runtime_error("Option not found");
-            break;
+            std::shared_ptr<char[]> request = getRequest(connection->socket());
+            std::string url = getUrl(request);
+            Option option = getOption(url);
+            Route route = routes.at(option);
+            // 不等待处理结果: 慢的 background 任务不会挡住后面的交互请求
+            ThreadPool::Executors::get(route.executor).addTask(route.priority, url, Handle, connection, option, std::string(request.get()));
         }
+        catch (const std::exception &e)
+        {
+            sendError(connection->socket(), e);
+        }
+    }
+
+    // accept 线程只负责把连接交出去, 不会被任何一个客户端阻塞
+    void Accept(SOCKET client_socket)
+    {
+        connections.addTask("connection", Execute, std::make_shared<Connection>(client_socket));
     }
 }
 
@@ -5,29 +5,66 @@ BOOL WINAPI CTRLHandler(DWORD sig)
     if (sig == CTRL_C_EVENT)
     {
         std::cout << "destory executed" << std::endl;
-        server::pool.setStop(true);
-        int before = server::pool.getLeftTasksAmount();
+        ThreadPool::Executors::stopAll();
+        int before = ThreadPool::Executors::getLeftTasksAmount();
         std::cout << "left tasks: " << before << std::endl;
-        while (server::pool.getLeftTasksAmount() != 0)
+        while (ThreadPool::Executors::getLeftTasksAmount() != 0)
         {
-            if (before != server::pool.getLeftTasksAmount())
+            if (before != ThreadPool::Executors::getLeftTasksAmount())
             {
-                std::cout << "left tasks: " << server::pool.getLeftTasksAmount() << std::endl;
+                std::cout << "left tasks: " << ThreadPool::Executors::getLeftTasksAmount() << std::endl;
             }
         }
         return TRUE;
     }else return FALSE;
 }
 
-int main()
+// StartUp [--port N] [--replication-port N] [--follow host:port]
+//   --replication-port  作为主节点, 在该端口接受从节点
+//   --follow            作为只读从节点, 从主节点同步商店目录; host 可以是主机名、
+//                       IPv4 地址或用方括号括起来的 IPv6 地址, 如 [::1]:9000
+// 不是从节点时, 商店目录的修改记录追加到 storesList.txt
+int main(int argc, char *argv[])
 {
+    int port = 1024;
+    int replicationPort = 0;
+    std::string primaryAddress;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string option = argv[i];
+        if (option == "--port")
+            port = std::stoi(argv[i + 1]);
+        else if (option == "--replication-port")
+            replicationPort = std::stoi(argv[i + 1]);
+        else if (option == "--follow")
+            primaryAddress = argv[i + 1];
+        else
+            throw std::runtime_error("Unknown option " + option);
+    }
+
     if (SetConsoleCtrlHandler(CTRLHandler, TRUE))
     {
-        SOCKET server_socket = server::init(1024);
+        if (primaryAddress.empty())
+            server::primary.openLog("storesList.txt");
+        SOCKET server_socket = server::init(port);
+        if (replicationPort)
+            server::primary.listen(replicationPort);
+        if (!primaryAddress.empty())
+        {
+            size_t colon = primaryAddress.rfind(':');
+            if (colon == std::string::npos)
+            {
+                throw std::runtime_error("--follow expects host:port");
+            }
+            std::string host = primaryAddress.substr(0, colon);
+            if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+                host = host.substr(1, host.size() - 2);
+            server::follower.follow(host, std::stoi(primaryAddress.substr(colon + 1)));
+        }
         while (true)
         {
             SOCKET client_socket = server::CreateConnection(server_socket);
-            server::Execute(client_socket);
+            server::Accept(client_socket);
         }
     }
     else
@@ -0,0 +1,48 @@
+#ifndef STORE_HPP_
+#define STORE_HPP_
+
+#include <string>
+#include <tuple>
+#include <vector>
+#include "Serializer.hpp"
+
+namespace server
+{
+    struct Dish
+    {
+        std::string name;
+        int price;
+        std::string unit;
+        unsigned long imageBinary;
+    };
+    struct Store
+    {
+        std::string name;
+        std::string address;
+        std::string bindPassword;
+        std::string phoneNum;
+        int customerAmount = 0;
+        std::vector<Dish> dishes;
+    };
+
+    // 字段描述, 供 Serializer.hpp 中的 JSON / 二进制编码器使用
+    constexpr auto describe(const Dish *)
+    {
+        return std::make_tuple(serializer::field("name", &Dish::name),
+                               serializer::field("price", &Dish::price),
+                               serializer::field("unit", &Dish::unit),
+                               serializer::field("imageBinary", &Dish::imageBinary));
+    }
+
+    constexpr auto describe(const Store *)
+    {
+        return std::make_tuple(serializer::field("name", &Store::name),
+                               serializer::field("address", &Store::address),
+                               serializer::internalField("bindPassword", &Store::bindPassword),
+                               serializer::field("phoneNum", &Store::phoneNum),
+                               serializer::field("customerAmount", &Store::customerAmount),
+                               serializer::field("dishes", &Store::dishes));
+    }
+}
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef THREADPOOL_HPP_
+#define THREADPOOL_HPP_
+
 #include <iostream>
 #include <vector>
 #include <deque>
@@ -9,6 +12,8 @@
 #include <atomic>
 #include <string>
 #include <memory>
+#include <map>
+#include <array>
 
 using namespace std;
 using TaskFunction = function<void()>;
@@ -22,15 +27,39 @@ namespace ThreadPool
         string name;
     };
 
+    // 优先级通道, 数值越小越优先
+    enum class Priority
+    {
+        High,
+        Normal,
+        Low
+    };
+    constexpr size_t laneAmount = 3;
+
+    // 通道之间的调度方式
+    // Strict: 高优先级通道不空就一直取高优先级
+    // WeightedFair: 按权重轮转, 低优先级也能持续得到执行
+    enum class Schedule
+    {
+        Strict,
+        WeightedFair
+    };
+
     // 线程池
     class ThreadPool
     {
     public:
         static ThreadPool getInstance() {return ThreadPool(); }
 
-        ThreadPool()
+        ThreadPool() : ThreadPool(thread::hardware_concurrency() > 8 ? 8 : thread::hardware_concurrency()) {}
+
+        explicit ThreadPool(unsigned int threadAmount, Schedule schedule = Schedule::WeightedFair,
+                            array<int, laneAmount> weights = {8, 4, 1})
+            : schedule(schedule), weights(weights)
         {
-            for (unsigned int i = 0; i < (thread::hardware_concurrency() > 8 ? 8 : thread::hardware_concurrency()); ++i)
+            if (threadAmount == 0)
+                threadAmount = 1;
+            for (unsigned int i = 0; i < threadAmount; ++i)
             {
                 threads.push_back(thread(&ThreadPool::run, this));
             }
@@ -39,21 +68,37 @@ namespace ThreadPool
 
         ~ThreadPool()
         {
-            if (stop)
+            stop.store(true);
+            runCV.notify_all();
+            for (auto &t : threads)
             {
-                runCV.notify_all();
-                for (auto &t : threads)
-                {
+                if (t.joinable())
                     t.join();
-                }; // 未知原因阻塞主线程
             }
         }
 
-        void setStop(bool flag){stop.store(flag);}
-        int getLeftTasksAmount(){return tasks.size();}
+        void setStop(bool flag)
+        {
+            stop.store(flag);
+            runCV.notify_all();
+        }
+        int getLeftTasksAmount()
+        {
+            lock_guard<mutex> lock(tasksLock);
+            size_t amount = 0;
+            for (auto &lane : lanes)
+                amount += lane.size();
+            return static_cast<int>(amount);
+        }
 
         template <class F, class... Args>
         auto addTask(string name, F &&f, Args &&...args) -> std::future<decltype(f(args...))>
+        {
+            return addTask(Priority::Normal, move(name), forward<F>(f), forward<Args>(args)...);
+        }
+
+        template <class F, class... Args>
+        auto addTask(Priority priority, string name, F &&f, Args &&...args) -> std::future<decltype(f(args...))>
         {
             using returnType = decltype(f(args...));
             auto task = make_shared<packaged_task<returnType()>>(bind(forward<F>(f), forward<Args>(args)...));
@@ -65,8 +110,8 @@ namespace ThreadPool
                     throw runtime_error("addtask on stopped ThreadPool");
                 }
                 else
-                    tasks.push_back(Task{[task]()
-                                         { (*task)(); }, name});
+                    lanes[static_cast<size_t>(priority)].push_back(Task{[task]()
+                                                                        { (*task)(); }, name});
                 lock.unlock();
             }
             runCV.notify_one();
@@ -93,42 +138,131 @@ namespace ThreadPool
         //     }
         // }
 
+        bool hasTask() const
+        {
+            for (auto &lane : lanes)
+                if (!lane.empty())
+                    return true;
+            return false;
+        }
+
+        // 调用前必须持有 tasksLock 且至少有一个通道非空
+        size_t pickLane()
+        {
+            if (schedule == Schedule::Strict)
+            {
+                for (size_t i = 0; i < laneAmount; ++i)
+                    if (!lanes[i].empty())
+                        return i;
+            }
+            // 平滑加权轮转: 每轮给非空通道加上权重, 取最大者并扣掉本轮总权重
+            int total = 0;
+            size_t best = laneAmount;
+            for (size_t i = 0; i < laneAmount; ++i)
+            {
+                if (lanes[i].empty())
+                    continue;
+                credits[i] += weights[i];
+                total += weights[i];
+                if (best == laneAmount || credits[i] > credits[best])
+                    best = i;
+            }
+            credits[best] -= total;
+            return best;
+        }
+
         void run()
         {
             while (true)
             {
-                if (!stop)
+                Task task;
                 {
                     unique_lock<mutex> lock(tasksLock);
                     runCV.wait(lock, [this]()
-                               { return !tasks.empty(); });
-                    TaskFunction task;
-                    string name;
-                    {
-                        lock_guard<mutex> lock(tasksLock);
-                        task = tasks.front().func;
-                        name = tasks.front().name;
-                        tasks.pop_front();
-                    }
-                    task();
+                               { return stop.load() || hasTask(); });
+                    if (!hasTask())
                     {
-                        unique_lock<mutex> lock(tasksLock);
-                        cout << "Task: " << name << " completed" << endl;
-                        lock.unlock();
+                        // 停止后把已经排队的任务做完再退出
+                        cout << this_thread::get_id() << "finished" << endl;
+                        return;
                     }
+                    deque<Task> &lane = lanes[pickLane()];
+                    task = move(lane.front());
+                    lane.pop_front();
                 }
-                else
+                task.func();
                 {
-                    cout << this_thread::get_id() << "finished" << endl;
+                    unique_lock<mutex> lock(tasksLock);
+                    cout << "Task: " << task.name << " completed" << endl;
+                    lock.unlock();
                 }
             }
         }
         vector<thread> threads;
-        deque<Task> tasks;
+        array<deque<Task>, laneAmount> lanes;
+        Schedule schedule;
+        array<int, laneAmount> weights;
+        array<int, laneAmount> credits{};
         mutex tasksLock;
         condition_variable runCV;
         atomic<bool> stop{false};
     };
+
+    // 命名执行器: 每个执行器是一个独立的线程池, 慢任务放到自己的执行器里,
+    // 不会占满处理交互请求的线程
+    class Executors
+    {
+    public:
+        static ThreadPool &create(const string &name, unsigned int threadAmount,
+                                  Schedule schedule = Schedule::WeightedFair)
+        {
+            lock_guard<mutex> lock(registryLock());
+            auto &pool = registry()[name];
+            if (!pool)
+                pool = make_unique<ThreadPool>(threadAmount, schedule);
+            return *pool;
+        }
+
+        static ThreadPool &get(const string &name)
+        {
+            lock_guard<mutex> lock(registryLock());
+            auto it = registry().find(name);
+            if (it == registry().end())
+            {
+                throw runtime_error("Executor not found: " + name);
+            }
+            return *it->second;
+        }
+
+        static void stopAll()
+        {
+            lock_guard<mutex> lock(registryLock());
+            for (auto &entry : registry())
+                entry.second->setStop(true);
+        }
+
+        static int getLeftTasksAmount()
+        {
+            lock_guard<mutex> lock(registryLock());
+            int amount = 0;
+            for (auto &entry : registry())
+                amount += entry.second->getLeftTasksAmount();
+            return amount;
+        }
+
+    private:
+        static map<string, unique_ptr<ThreadPool>> &registry()
+        {
+            static map<string, unique_ptr<ThreadPool>> pools;
+            return pools;
+        }
+
+        static mutex &registryLock()
+        {
+            static mutex lock;
+            return lock;
+        }
+    };
 }
 
 // int main()
@@ -147,4 +281,6 @@ namespace ThreadPool
 //     cout << "Result: " << res.get() << endl;
 //     pool->~ThreadPool();
 //     return 0;
-// }
\ No newline at end of file
+// }
+
+#endif
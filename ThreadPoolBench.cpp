@@ -0,0 +1,112 @@
+// 交互请求延迟测试: background 任务持续积压时, 测量交互任务从提交到完成的 p50/p99,
+// 以及同一时间 background 任务的完成速度.
+// g++ -std=gnu++17 -O2 ThreadPoolBench.cpp -o ThreadPoolBench -pthread
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ThreadPool.hpp"
+
+using Clock = chrono::steady_clock;
+
+struct Result
+{
+    double p50;
+    double p99;
+    double backgroundPerSecond;
+};
+
+// 丢弃所有输出且没有内部状态, 多个线程池的工作线程同时写也没有数据竞争
+class NullBuffer : public streambuf
+{
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    streamsize xsputn(const char *, streamsize count) override { return count; }
+};
+
+// 每个 background 任务模拟一次 2ms 的磁盘写入, 提交方让积压一直保持在 backlog 个左右;
+// 同时每毫秒提交一个几乎不耗时的交互任务
+static Result run(ThreadPool::ThreadPool &interactive, ThreadPool::Priority interactivePriority,
+                  ThreadPool::ThreadPool &background, ThreadPool::Priority backgroundPriority)
+{
+    const int probes = 500;
+    const int backlog = 200;
+    atomic<int> pending{0};
+    atomic<int> finished{0};
+    atomic<bool> stop{false};
+
+    thread producer([&]()
+                    {
+        while (!stop.load())
+        {
+            if (pending.load() < backlog)
+            {
+                ++pending;
+                background.addTask(backgroundPriority, "background", [&]()
+                                   {
+                    this_thread::sleep_for(chrono::milliseconds(2));
+                    ++finished;
+                    // 必须是任务里最后一次访问 run() 的局部变量: pending 归零后 run() 就会返回
+                    --pending; });
+            }
+            else
+                this_thread::sleep_for(chrono::microseconds(100));
+        } });
+
+    this_thread::sleep_for(chrono::milliseconds(100));
+    int finishedBefore = finished.load();
+    auto start = Clock::now();
+    vector<double> latencies;
+    for (int i = 0; i < probes; ++i)
+    {
+        auto submitted = Clock::now();
+        auto done = interactive.addTask(interactivePriority, "interactive", [submitted]()
+                                        { return chrono::duration<double, milli>(Clock::now() - submitted).count(); });
+        latencies.push_back(done.get());
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+    int backgroundDone = finished.load() - finishedBefore;
+    stop.store(true);
+    producer.join();
+    while (pending.load() > 0)
+        this_thread::sleep_for(chrono::milliseconds(10));
+
+    sort(latencies.begin(), latencies.end());
+    return Result{latencies[probes / 2], latencies[probes * 99 / 100], backgroundDone / seconds};
+}
+
+int main()
+{
+    // 线程池每完成一个任务都会打印一行, 测试期间先屏蔽. 工作线程随时可能在写 cout,
+    // 所以只在所有线程池都析构之后才恢复输出, 结果先存起来最后一起打印
+    streambuf *console = cout.rdbuf();
+    NullBuffer discard;
+    cout.rdbuf(&discard);
+
+    vector<pair<string, Result>> results;
+    {
+        ThreadPool::ThreadPool shared(4);
+        results.emplace_back("one pool, one lane ", run(shared, ThreadPool::Priority::Normal, shared, ThreadPool::Priority::Normal));
+    }
+    {
+        ThreadPool::ThreadPool weighted(4, ThreadPool::Schedule::WeightedFair);
+        results.emplace_back("one pool, weighted ", run(weighted, ThreadPool::Priority::High, weighted, ThreadPool::Priority::Low));
+    }
+    {
+        ThreadPool::ThreadPool strict(4, ThreadPool::Schedule::Strict);
+        results.emplace_back("one pool, strict   ", run(strict, ThreadPool::Priority::High, strict, ThreadPool::Priority::Low));
+    }
+    {
+        ThreadPool::ThreadPool interactive(2);
+        ThreadPool::ThreadPool background(2);
+        results.emplace_back("separate executors ", run(interactive, ThreadPool::Priority::High, background, ThreadPool::Priority::Low));
+    }
+
+    cout.rdbuf(console);
+    for (auto &result : results)
+        cout << result.first << ": interactive p50 " << result.second.p50 << " ms, p99 " << result.second.p99
+             << " ms, background " << result.second.backgroundPerSecond << " tasks/s" << endl;
+    return 0;
+}
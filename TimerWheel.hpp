@@ -0,0 +1,279 @@
+#ifndef TIMERWHEEL_HPP_
+#define TIMERWHEEL_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace TimerWheel
+{
+    using Callback = std::function<void()>;
+
+    // 定时器句柄, generation 用来识别已经被复用的节点, 过期句柄 cancel 无副作用
+    struct TimerId
+    {
+        std::uint32_t index = UINT32_MAX;
+        std::uint32_t generation = 0;
+    };
+
+    // 分层时间轮 (和 Linux 内核 timer wheel 同样的结构)
+    // 第 0 层 256 格, 每格一个 tick; 第 1~3 层各 64 格, 每层粒度是上一层的整圈.
+    // 添加/取消都是 O(1) 的链表操作, 高层的定时器在低层转完一圈时才整体下沉一次.
+    //
+    // 节点放在一个 vector 里用下标串成双向链表, 释放后进空闲链表复用,
+    // 几十万个定时器也不会频繁分配内存.
+    class TimerWheel
+    {
+    public:
+        explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(10)) : tick(tick)
+        {
+            heads.fill(nil);
+        }
+
+        ~TimerWheel() { stop(); }
+
+        TimerWheel(const TimerWheel &) = delete;
+        TimerWheel &operator=(const TimerWheel &) = delete;
+
+        TimerId schedule(std::chrono::milliseconds delay, Callback callback)
+        {
+            std::uint64_t ticks = delay.count() <= 0 ? 1 : (delay.count() + tick.count() - 1) / tick.count();
+            std::lock_guard<std::mutex> lock(wheelLock);
+            std::uint32_t index = allocate();
+            Node &node = nodes[index];
+            node.expires = current + (ticks < maxTicks ? ticks : maxTicks - 1);
+            node.callback = std::move(callback);
+            link(index);
+            ++armed;
+            return TimerId{index, node.generation};
+        }
+
+        // 返回 false 表示定时器已经触发过或者已经被取消.
+        // 回调正在执行时会等它执行完再返回, 所以 cancel 返回之后回调一定不会再运行
+        // (在回调里取消自己除外, 那样不等待).
+        bool cancel(TimerId id)
+        {
+            std::unique_lock<std::mutex> lock(wheelLock);
+            if (id.index >= nodes.size() || nodes[id.index].generation != id.generation)
+                return false;
+            if (nodes[id.index].list != nil)
+            {
+                unlink(id.index);
+                release(id.index);
+                --armed;
+                return true;
+            }
+            if (nodes[id.index].running && std::this_thread::get_id() != firingThread)
+                firedCV.wait(lock, [&]()
+                             { return nodes[id.index].generation != id.generation; });
+            return false;
+        }
+
+        size_t size()
+        {
+            std::lock_guard<std::mutex> lock(wheelLock);
+            return armed;
+        }
+
+        // 时间前进 ticks 格, 到期的回调在释放锁之后依次执行, 回调里可以再 schedule/cancel.
+        // 同一时间只能有一个线程调用 advance (通常就是 start() 启动的驱动线程).
+        size_t advance(std::uint64_t ticks)
+        {
+            std::vector<std::pair<std::uint32_t, Callback>> due;
+            {
+                std::lock_guard<std::mutex> lock(wheelLock);
+                firingThread = std::this_thread::get_id();
+                for (std::uint64_t i = 0; i < ticks; ++i)
+                {
+                    size_t slot = ++current & (level0Slots - 1);
+                    if (slot == 0 && cascade(1) == 0 && cascade(2) == 0)
+                        cascade(3);
+                    std::uint32_t index = heads[slot];
+                    heads[slot] = nil;
+                    while (index != nil)
+                    {
+                        std::uint32_t next = nodes[index].next;
+                        // 回调执行完之前节点不回收, cancel 据此等待
+                        nodes[index].list = nil;
+                        nodes[index].running = true;
+                        due.emplace_back(index, std::move(nodes[index].callback));
+                        --armed;
+                        index = next;
+                    }
+                }
+            }
+            for (auto &entry : due)
+            {
+                entry.second();
+                {
+                    std::lock_guard<std::mutex> lock(wheelLock);
+                    nodes[entry.first].running = false;
+                    release(entry.first);
+                }
+                firedCV.notify_all();
+            }
+            return due.size();
+        }
+
+        // 启动驱动线程, 按真实时间推进时间轮
+        void start()
+        {
+            if (running.exchange(true))
+                return;
+            driver = std::thread([this]()
+                                 {
+                auto last = std::chrono::steady_clock::now();
+                std::unique_lock<std::mutex> lock(driverLock);
+                while (running)
+                {
+                    driverCV.wait_for(lock, tick);
+                    auto now = std::chrono::steady_clock::now();
+                    std::uint64_t elapsed = (now - last) / tick;
+                    if (elapsed == 0)
+                        continue;
+                    last += tick * elapsed;
+                    lock.unlock();
+                    advance(elapsed);
+                    lock.lock();
+                } });
+        }
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(driverLock);
+                if (!running.exchange(false))
+                    return;
+            }
+            driverCV.notify_all();
+            if (driver.joinable())
+                driver.join();
+        }
+
+    private:
+        static constexpr std::uint32_t nil = UINT32_MAX;
+        static constexpr int level0Bits = 8;
+        static constexpr int levelBits = 6;
+        static constexpr size_t level0Slots = size_t(1) << level0Bits;
+        static constexpr size_t levelSlots = size_t(1) << levelBits;
+        static constexpr std::uint64_t maxTicks = std::uint64_t(1) << (level0Bits + 3 * levelBits);
+
+        struct Node
+        {
+            std::uint64_t expires = 0;
+            Callback callback;
+            std::uint32_t prev = nil;
+            std::uint32_t next = nil;
+            std::uint32_t list = nil;
+            std::uint32_t generation = 0;
+            bool running = false;
+        };
+
+        std::uint32_t allocate()
+        {
+            if (freeHead != nil)
+            {
+                std::uint32_t index = freeHead;
+                freeHead = nodes[index].next;
+                return index;
+            }
+            nodes.emplace_back();
+            return static_cast<std::uint32_t>(nodes.size() - 1);
+        }
+
+        void release(std::uint32_t index)
+        {
+            Node &node = nodes[index];
+            node.callback = nullptr;
+            node.list = nil;
+            node.prev = nil;
+            ++node.generation;
+            node.next = freeHead;
+            freeHead = index;
+        }
+
+        // 根据到期时间和当前时间的差值选择层和格
+        std::uint32_t listFor(std::uint64_t expires) const
+        {
+            if (expires < current)
+                expires = current;
+            std::uint64_t delta = expires - current;
+            if (delta < level0Slots)
+                return static_cast<std::uint32_t>(expires & (level0Slots - 1));
+            for (int level = 1; level <= 3; ++level)
+            {
+                int shift = level0Bits + level * levelBits;
+                if (level == 3 || delta < (std::uint64_t(1) << shift))
+                {
+                    size_t slot = (expires >> (shift - levelBits)) & (levelSlots - 1);
+                    return static_cast<std::uint32_t>(level0Slots + (level - 1) * levelSlots + slot);
+                }
+            }
+            return nil;
+        }
+
+        void link(std::uint32_t index)
+        {
+            Node &node = nodes[index];
+            node.list = listFor(node.expires);
+            node.prev = nil;
+            node.next = heads[node.list];
+            if (node.next != nil)
+                nodes[node.next].prev = index;
+            heads[node.list] = index;
+        }
+
+        void unlink(std::uint32_t index)
+        {
+            Node &node = nodes[index];
+            if (node.prev != nil)
+                nodes[node.prev].next = node.next;
+            else
+                heads[node.list] = node.next;
+            if (node.next != nil)
+                nodes[node.next].prev = node.prev;
+            node.list = nil;
+        }
+
+        // 把第 level 层当前格里的定时器重新放回更低的层, 返回该格下标
+        size_t cascade(int level)
+        {
+            int shift = level0Bits + (level - 1) * levelBits;
+            size_t slot = (current >> shift) & (levelSlots - 1);
+            size_t list = level0Slots + (level - 1) * levelSlots + slot;
+            std::uint32_t index = heads[list];
+            heads[list] = nil;
+            while (index != nil)
+            {
+                std::uint32_t next = nodes[index].next;
+                link(index);
+                index = next;
+            }
+            return slot;
+        }
+
+        std::chrono::milliseconds tick;
+        std::vector<Node> nodes;
+        std::array<std::uint32_t, level0Slots + 3 * levelSlots> heads;
+        std::uint32_t freeHead = nil;
+        std::uint64_t current = 0; // 最近一次处理过的 tick
+        size_t armed = 0;
+        std::mutex wheelLock;
+        std::condition_variable firedCV;
+        std::thread::id firingThread;
+
+        std::thread driver;
+        std::atomic<bool> running{false};
+        std::mutex driverLock;
+        std::condition_variable driverCV;
+    };
+}
+
+#endif